@@ -14,6 +14,7 @@
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -42,12 +43,17 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <queue>
+#include <regex>
 #include <set>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
@@ -92,6 +98,13 @@ struct TrackInfo {
     std::string trackName;
 };
 
+// Instrument shown in the log and --probe output.
+static std::string instrumentLabel(const TrackInfo& ti) {
+    if (ti.hasChannel10) return "Percussion (Ch10)";
+    if (ti.programGuess >= 0 && ti.programGuess < 128) return GM_NAMES[ti.programGuess];
+    return "Unknown";
+}
+
 struct NoteSpan {
     int startTick;
     int endTick;
@@ -192,6 +205,7 @@ std::vector<unsigned char> bytesFromEvent(const MidiEvent& e) {
 struct Logger {
     std::ofstream file;
     bool ok = false;
+    bool quiet = false;     // no console echo (fuzzing)
 
     void openAt(const fs::path& p) {
         file.open(p, std::ios::out | std::ios::trunc);
@@ -199,10 +213,23 @@ struct Logger {
     }
     void line(const std::string& s) {
         if (ok) { file << s << "\n"; file.flush(); }
-        std::cout << s << "\n";
+        if (!quiet) std::cout << s << "\n";
     }
 };
 
+#ifndef MIDIBREAKOUT_FUZZ // CLI only
+// Opens the log next to the EXE, falling back to `fallbackDir`.
+static fs::path openLog(Logger& log, const fs::path& fallbackDir) {
+    fs::path logPath = exeDir() / "MIDI_Voice_Separation_Log.txt";
+    log.openAt(logPath);
+    if (!log.ok) {
+        logPath = fallbackDir / "MIDI_Voice_Separation_Log.txt";
+        log.openAt(logPath);
+    }
+    return logPath;
+}
+#endif
+
 // ------------------------ Scanning & Meta Copy ------------------------
 
 std::vector<TrackInfo> scanTrackInfo(const MidiFile& in) {
@@ -291,13 +318,24 @@ void collectChannelSetupAndAutomation(const MidiFile& in, int srcTrack,
 
 // ------------------------ Note Extraction & Voices ------------------------
 
-static std::vector<NoteSpan> extractTrackNotes(const MidiFile& in, int trackIndex, std::set<int>* channelsSeen = nullptr) {
+// What extractTrackNotes() had to repair. Orphan note-offs have no matching
+// note-on and are ignored; note-ons still open at the end of the track are
+// closed at the track's last tick instead of being dropped.
+struct NoteStats {
+    int orphanOffs  = 0;
+    int closedAtEnd = 0;
+};
+
+static std::vector<NoteSpan> extractTrackNotes(const MidiFile& in, int trackIndex, std::set<int>* channelsSeen = nullptr,
+                                               NoteStats* stats = nullptr) {
     struct OnInfo { int tick; int vel; };
     std::unordered_map<int, std::vector<OnInfo>> ons; // (ch<<8)|pitch
     std::vector<NoteSpan> notes;
+    int lastTick = 0;
 
     for (int i = 0; i < in[trackIndex].getEventCount(); ++i) {
         const auto& ev = in[trackIndex][i];
+        if (ev.tick > lastTick) lastTick = ev.tick;
         int ch, p, v;
         if (isNoteOn(ev, ch, p, v)) {
             if (channelsSeen) channelsSeen->insert(ch);
@@ -311,9 +349,17 @@ static std::vector<NoteSpan> extractTrackNotes(const MidiFile& in, int trackInde
                 it->second.pop_back();
                 int endT = std::max(ev.tick, on.tick + 1); // never zero-length
                 notes.push_back({on.tick, endT, p, on.vel, ch});
+            } else if (stats) {
+                stats->orphanOffs++;
             }
         }
     }
+    for (auto& kv : ons) {
+        for (const OnInfo& on : kv.second) {
+            notes.push_back({on.tick, std::max(lastTick, on.tick + 1), kv.first & 0xFF, on.vel, kv.first >> 8});
+            if (stats) stats->closedAtEnd++;
+        }
+    }
     std::sort(notes.begin(), notes.end(),
               [](const NoteSpan& a, const NoteSpan& b){
                   if (a.startTick != b.startTick) return a.startTick < b.startTick;
@@ -322,11 +368,113 @@ static std::vector<NoteSpan> extractTrackNotes(const MidiFile& in, int trackInde
     return notes;
 }
 
-static std::vector<std::vector<NoteSpan>> extractVoicesFromTrack(const MidiFile& in,
-                                                                 int trackIndex,
-                                                                 bool /*keepOverlaps*/) {
-    std::vector<NoteSpan> notes = extractTrackNotes(in, trackIndex, nullptr);
+static void logNoteStats(const NoteStats& st, Logger& log) {
+    if (st.orphanOffs)  log.line("  Orphan note-offs ignored: " + std::to_string(st.orphanOffs));
+    if (st.closedAtEnd) log.line("  Hanging notes closed at track end: " + std::to_string(st.closedAtEnd));
+}
+
+// Voice assignment options. The default is the original greedy pass (each chord
+// note, highest first, takes the first free lane). Voice-leading mode instead
+// solves a min-cost matching per start tick so lanes move as little as possible.
+struct VoiceOptions {
+    bool voiceLeading = false;
+    int  maxVoices    = 0;   // voice-leading only; 0 = unlimited
+};
+
+// What the voice cap had to do to hold.
+struct VoiceStats {
+    int stackedTones = 0;   // chord tones sharing a voice because the chord was wider than the cap
+};
+
+// Matching costs. Opening a lane costs more than any pitch move (0..127), so a
+// new voice is only created when no free lane exists. Stealing a sounding lane
+// (only offered when capped) costs more again, so it is the last resort before
+// stacking. These orderings fix how many tones go to each kind of lane.
+static const int kOpenLaneCost  = 128;
+static const int kStealLaneCost = 256;
+
+// Above this many DP cells a chord is matched by the linear fallback instead.
+static const size_t kMaxAssignCells = (size_t)1 << 18;
+
+// Buffers reused across chords so matching does not allocate per start tick.
+struct AssignScratch {
+    std::vector<int> dp;
+    std::vector<unsigned char> how;     // 1 skip tone, 2 skip lane, 3 match
+    std::vector<int> order;
+};
+
+// Matches pitch-sorted chord tones to pitch-sorted lanes. The cost is
+// |dpitch| + laneCost per matched pair and skipCost per unmatched tone; with
+// 1-D distances some optimal matching never crosses, so a DP over (tone, lane)
+// is exact in O(k * lanes). With exact >= 0 exactly that many tones must be
+// matched, which adds a matched-count dimension (only used under a voice cap,
+// where lanes <= cap). Returns per tone the lane position, or -1.
+static std::vector<int> orderedAssignment(const std::vector<int>& tone, const std::vector<int>& lane,
+                                          const std::vector<int>& laneCost, int skipCost, int exact,
+                                          AssignScratch& sc) {
+    const int k = (int)tone.size(), L = (int)lane.size();
+    const int M = exact < 0 ? 0 : exact;
+    const size_t D = (size_t)M + 1;
+    const size_t cells = (size_t)(k + 1) * (L + 1) * D;
+    std::vector<int> res(k, -1);
+
+    if (k == 1 && exact < 0) {
+        // Single note (the common case): plain argmin.
+        int best = skipCost;
+        for (int j = 0; j < L; ++j) {
+            int c = std::abs(tone[0] - lane[j]) + laneCost[j];
+            if (c < best) { best = c; res[0] = j; }
+        }
+        return res;
+    }
+    if (cells > kMaxAssignCells) {
+        // Linear fallback: take the cheapest lanes (free before stolen), then
+        // pair them in pitch order with evenly spaced tones.
+        int m = exact < 0 ? std::min(k, L) : M;
+        sc.order.resize(L);
+        for (int j = 0; j < L; ++j) sc.order[j] = j;
+        std::stable_sort(sc.order.begin(), sc.order.end(),
+                         [&](int x, int y){ return laneCost[x] < laneCost[y]; });
+        sc.order.resize(m);
+        std::sort(sc.order.begin(), sc.order.end());
+        for (int t = 0; t < m; ++t) res[(int)((long long)t * k / m)] = sc.order[t];
+        return res;
+    }
+
+    const int INF = std::numeric_limits<int>::max();
+    auto at = [&](int i, int j, int c) { return ((size_t)i * (L + 1) + j) * D + c; };
+    sc.dp.assign(cells, INF);
+    sc.how.assign(cells, 0);
+    auto relax = [&](size_t dst, int val, unsigned char h) {
+        if (val < sc.dp[dst]) { sc.dp[dst] = val; sc.how[dst] = h; }
+    };
+    sc.dp[at(0, 0, 0)] = 0;
+    for (int i = 0; i <= k; ++i) {
+        for (int j = 0; j <= L; ++j) {
+            for (int c = 0; c <= M; ++c) {
+                int cur = sc.dp[at(i, j, c)];
+                if (cur == INF) continue;
+                if (i < k) relax(at(i + 1, j, c), cur + skipCost, 1);
+                if (j < L) relax(at(i, j + 1, c), cur, 2);
+                int c2 = exact < 0 ? 0 : c + 1;
+                if (i < k && j < L && c2 <= M)
+                    relax(at(i + 1, j + 1, c2), cur + std::abs(tone[i] - lane[j]) + laneCost[j], 3);
+            }
+        }
+    }
+
+    int i = k, j = L, c = M;
+    while (i > 0 || j > 0) {
+        unsigned char h = sc.how[at(i, j, c)];
+        if (h == 1) { --i; }
+        else if (h == 2) { --j; }
+        else { --i; --j; res[i] = j; if (exact >= 0) --c; }
+    }
+    return res;
+}
 
+// Original pass: chord notes by descending pitch take free lanes in lane order.
+static std::vector<std::vector<NoteSpan>> assignVoicesGreedy(const std::vector<NoteSpan>& notes) {
     std::map<int, std::vector<int>> byStart;
     for (int i = 0; i < (int)notes.size(); ++i) byStart[notes[i].startTick].push_back(i);
 
@@ -359,7 +507,104 @@ static std::vector<std::vector<NoteSpan>> extractVoicesFromTrack(const MidiFile&
             }
         }
     }
+    return voices;
+}
+
+// End of a lane's current sound: its last note, or the longest tone of a
+// chord stacked onto it by the voice cap.
+static int laneEnd(const std::vector<NoteSpan>& lane) {
+    int start = lane.back().startTick, end = lane.back().endTick;
+    for (size_t n = lane.size() - 1; n > 0 && lane[n-1].startTick == start; --n)
+        end = std::max(end, lane[n-1].endTick);
+    return end;
+}
+
+// Voice-leading pass: per start tick, match the chord's notes to lanes so the
+// summed pitch movement is minimal. With a cap, sounding lanes may be stolen
+// (their current sound is cut at the new start), and tones of a chord wider
+// than the cap are stacked onto the lane holding the nearest chord tone, so
+// the voice count never exceeds the cap and no note is dropped.
+static std::vector<std::vector<NoteSpan>> assignVoicesLeading(const std::vector<NoteSpan>& notes,
+                                                              int maxVoices, VoiceStats* stats) {
+    std::vector<std::vector<NoteSpan>> voices;
+    AssignScratch scratch;
+    std::vector<int> freeLanes, busyLanes, lanes, lanePitch, laneCost, tonePitch, placed;
+
+    // notes are sorted by start tick (then descending pitch), so each chord is
+    // a contiguous run; reversed, its tones are in ascending pitch order.
+    size_t i = 0;
+    while (i < notes.size()) {
+        const int t = notes[i].startTick;
+        size_t j = i;
+        while (j < notes.size() && notes[j].startTick == t) ++j;
+        const int k = (int)(j - i);
+        auto toneAt = [&](int r) -> const NoteSpan& { return notes[j - 1 - r]; };
+
+        freeLanes.clear();
+        busyLanes.clear();
+        for (int vi = 0; vi < (int)voices.size(); ++vi)
+            (laneEnd(voices[vi]) > t ? busyLanes : freeLanes).push_back(vi);
+        const int F = (int)freeLanes.size(), B = (int)busyLanes.size();
+        const int opens = (maxVoices > 0) ? std::min(std::max(0, maxVoices - (int)voices.size()), k) : k;
+
+        // Free lanes always beat new ones, and new ones beat stealing. So only
+        // when free and new lanes cannot hold the chord (capped) are sounding
+        // lanes offered, and then exactly F + steals tones take existing lanes.
+        lanes = freeLanes;
+        int exact = -1;
+        if (maxVoices > 0 && k > F + opens) {
+            lanes.insert(lanes.end(), busyLanes.begin(), busyLanes.end());
+            exact = F + std::min(k - F - opens, B);
+        }
+        std::sort(lanes.begin(), lanes.end(), [&](int x, int y){
+            return voices[x].back().pitch < voices[y].back().pitch;
+        });
+        lanePitch.clear();
+        laneCost.clear();
+        for (int vi : lanes) {
+            lanePitch.push_back(voices[vi].back().pitch);
+            laneCost.push_back(laneEnd(voices[vi]) > t ? kStealLaneCost : 0);
+        }
+        tonePitch.clear();
+        for (int r = 0; r < k; ++r) tonePitch.push_back(toneAt(r).pitch);
+
+        std::vector<int> match = orderedAssignment(tonePitch, lanePitch, laneCost, kOpenLaneCost, exact, scratch);
+
+        placed.clear();
+        for (int r = 0; r < k; ++r) {
+            if (match[r] < 0) continue;
+            auto& v = voices[lanes[match[r]]];
+            // Stolen: every sounding tone started before t, so lengths stay >= 1.
+            int start = v.back().startTick;
+            for (size_t n = v.size(); n > 0 && v[n-1].startTick == start; --n)
+                if (v[n-1].endTick > t) v[n-1].endTick = t;
+            v.push_back(toneAt(r));
+            placed.push_back(lanes[match[r]]);
+        }
+        int opened = 0;
+        for (int r = 0; r < k; ++r) {
+            if (match[r] >= 0 || opened == opens) continue;
+            voices.push_back({ toneAt(r) });
+            placed.push_back((int)voices.size() - 1);
+            match[r] = -2;
+            opened++;
+        }
+        for (int r = 0; r < k; ++r) {
+            if (match[r] != -1) continue;
+            int best = placed.front();
+            for (int lane : placed)
+                if (std::abs(voices[lane].back().pitch - toneAt(r).pitch) <
+                    std::abs(voices[best].back().pitch - toneAt(r).pitch)) best = lane;
+            voices[best].push_back(toneAt(r));
+            if (stats) stats->stackedTones++;
+        }
+        i = j;
+    }
+    return voices;
+}
 
+// Orders voices from highest to lowest average pitch (voice1 = top line).
+static std::vector<std::vector<NoteSpan>> orderVoicesByPitch(std::vector<std::vector<NoteSpan>>& voices) {
     std::vector<std::pair<double,int>> avgPitch;
     for (int vi = 0; vi < (int)voices.size(); ++vi) {
         if (voices[vi].empty()) { avgPitch.push_back({-1e9, vi}); continue; }
@@ -375,6 +620,22 @@ static std::vector<std::vector<NoteSpan>> extractVoicesFromTrack(const MidiFile&
     return ordered;
 }
 
+static std::vector<std::vector<NoteSpan>> assignVoices(const std::vector<NoteSpan>& notes,
+                                                       const VoiceOptions& opt,
+                                                       VoiceStats* stats = nullptr) {
+    auto voices = opt.voiceLeading ? assignVoicesLeading(notes, opt.maxVoices, stats)
+                                   : assignVoicesGreedy(notes);
+    return orderVoicesByPitch(voices);
+}
+
+static std::vector<std::vector<NoteSpan>> extractVoicesFromTrack(const MidiFile& in,
+                                                                 int trackIndex,
+                                                                 const VoiceOptions& opt,
+                                                                 VoiceStats* stats = nullptr) {
+    std::vector<NoteSpan> notes = extractTrackNotes(in, trackIndex, nullptr);
+    return assignVoices(notes, opt, stats);
+}
+
 static int writeNotesAndReturnLastTick(MidiFile& out, const std::vector<NoteSpan>& notes) {
     int lastTick = 0;
     for (const auto& n : notes) {
@@ -433,13 +694,9 @@ static void ensureEndOfTrack(smf::MidiFile& mf) {
 }
 
 
-static bool writeMidiFile(smf::MidiFile& mf, const std::filesystem::path& p,
-                          Logger& log, const char* tag)
+// Normalizes timing, ordering and EOT so the file is ready for write().
+static void normalizeForWrite(smf::MidiFile& mf, Logger& log, const char* tag)
 {
-    namespace fs = std::filesystem;
-    std::error_code ec;
-    fs::create_directories(p.parent_path(), ec); // ensure folder exists
-
     // Normalize timing & ordering before writing.
     log.line(std::string("   [") + tag + "] absoluteTicks()");
     mf.absoluteTicks();
@@ -469,6 +726,17 @@ static bool writeMidiFile(smf::MidiFile& mf, const std::filesystem::path& p,
         log.line("   [" + std::string(tag) + "] track " + std::to_string(t) +
                  " events just before write: " + std::to_string((int)mf[t].size()));
     }
+}
+
+#ifndef MIDIBREAKOUT_FUZZ // CLI only
+static bool writeMidiFile(smf::MidiFile& mf, const std::filesystem::path& p,
+                          Logger& log, const char* tag)
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::create_directories(p.parent_path(), ec); // ensure folder exists
+
+    normalizeForWrite(mf, log, tag);
 
     fs::path full = p;
     log.line(std::string("   [") + tag + "] writing: " + full.string());
@@ -480,8 +748,41 @@ static bool writeMidiFile(smf::MidiFile& mf, const std::filesystem::path& p,
     }
     return ok;
 }
+#endif
+
+
+
+// Assembles one single-track stem: global metas, the source track's channel
+// setup/automation for `channels`, the notes, and an End-Of-Track.
+static void buildStemFile(MidiFile& out, const MidiFile& in, int trackIndex,
+                          const MetaCopy& meta, const std::set<int>& channels,
+                          const std::vector<NoteSpan>& notes,
+                          Logger& log, const std::string& tag) {
+    out.absoluteTicks();
+    out.addTrack(1);
+    out.setTicksPerQuarterNote(in.getTicksPerQuarterNote());
+
+    log.line("   [" + tag + "] copy global metas: " + std::to_string((int)meta.metas.size()));
+    for (auto& m : meta.metas) addMsg(out, 0, m.first, m.second);
 
+    std::vector<MidiEvent> chAuto;
+    collectChannelSetupAndAutomation(in, trackIndex, channels, chAuto);
+    int lastTick = 0;
+    log.line("   [" + tag + "] inject automation: " + std::to_string((int)chAuto.size()));
+    for (auto& ev : chAuto) {
+        addMsg(out, 0, ev.tick, bytesFromEvent(ev));
+        if (ev.tick > lastTick) lastTick = ev.tick;
+    }
+
+    int lastNoteTick = writeNotesAndReturnLastTick(out, notes);
+    log.line("   [" + tag + "] lastNoteTick = " + std::to_string(lastNoteTick));
+    if (lastNoteTick > lastTick) lastTick = lastNoteTick;
 
+    addEndOfTrack(out, lastTick);
+    log.line("   [" + tag + "] EOT at ~" + std::to_string(lastTick+1));
+}
+
+#ifndef MIDIBREAKOUT_FUZZ // CLI only
 
 // ------------------------ Drum Split (ch10) ------------------------
 
@@ -491,8 +792,10 @@ static void splitDrumTrack(const MidiFile& in,
                            const fs::path& outDir,
                            const std::string& baseName,
                            Logger& log) {
-    std::vector<NoteSpan> notes = extractTrackNotes(in, trackIndex, nullptr);
+    NoteStats stats;
+    std::vector<NoteSpan> notes = extractTrackNotes(in, trackIndex, nullptr, &stats);
     log.line("  [Drums] notes: " + std::to_string(notes.size()));
+    logNoteStats(stats, log);
     std::vector<NoteSpan> drums, cymbals;
     for (auto& n : notes) {
         if (n.channel == 9) {
@@ -510,29 +813,7 @@ static void splitDrumTrack(const MidiFile& in,
         }
 
         MidiFile out;
-        out.absoluteTicks();
-        out.addTrack(1);
-        out.setTicksPerQuarterNote(in.getTicksPerQuarterNote());
-
-        log.line("   [" + label + "] copy global metas: " + std::to_string((int)meta.metas.size()));
-        for (auto& m : meta.metas) addMsg(out, 0, m.first, m.second);
-
-        std::set<int> used { 9 };
-        std::vector<MidiEvent> chAuto;
-        collectChannelSetupAndAutomation(in, trackIndex, used, chAuto);
-        int lastTick = 0;
-        log.line("   [" + label + "] inject automation: " + std::to_string((int)chAuto.size()));
-        for (auto& ev : chAuto) {
-            addMsg(out, 0, ev.tick, bytesFromEvent(ev));
-            if (ev.tick > lastTick) lastTick = ev.tick;
-        }
-
-        int lastNoteTick = writeNotesAndReturnLastTick(out, set);
-        log.line("   [" + label + "] lastNoteTick = " + std::to_string(lastNoteTick));
-        if (lastNoteTick > lastTick) lastTick = lastNoteTick;
-
-        addEndOfTrack(out, lastTick);
-        log.line("   [" + label + "] EOT at ~" + std::to_string(lastTick+1));
+        buildStemFile(out, in, trackIndex, meta, std::set<int>{ 9 }, set, log, label);
 
         std::string fname = baseName + "-" + label + ".mid";
         writeMidiFile(out, outDir / fname, log, label.c_str());
@@ -550,15 +831,22 @@ static void splitTrackVoices(const MidiFile& in,
                              const fs::path& outDir,
                              const std::string& baseName,
                              const std::string& instrumentNameSafe,
+                             const VoiceOptions& voiceOpt,
                              Logger& log) {
 
     std::set<int> channels;
-    auto allNotes = extractTrackNotes(in, trackIndex, &channels);
+    NoteStats stats;
+    auto allNotes = extractTrackNotes(in, trackIndex, &channels, &stats);
     log.line("  Notes found: " + std::to_string(allNotes.size()) +
              " | channels used: " + std::to_string(channels.size()));
+    logNoteStats(stats, log);
 
-    auto voices = extractVoicesFromTrack(in, trackIndex, true);
+    VoiceStats vstats;
+    auto voices = extractVoicesFromTrack(in, trackIndex, voiceOpt, &vstats);
     log.line("  Voices: " + std::to_string(voices.size()));
+    if (vstats.stackedTones)
+        log.line("  Voice cap " + std::to_string(voiceOpt.maxVoices) + " held by stacking " +
+                 std::to_string(vstats.stackedTones) + " chord tones onto shared voices");
     if (voices.empty()) {
         log.line("  No voices (skip).");
         return;
@@ -570,28 +858,7 @@ static void splitTrackVoices(const MidiFile& in,
         if (voice.empty()) { vnum++; continue; }
 
         MidiFile out;
-        out.absoluteTicks();
-        out.addTrack(1);
-        out.setTicksPerQuarterNote(in.getTicksPerQuarterNote());
-
-        log.line("   [voice" + std::to_string(vnum) + "] copy global metas: " + std::to_string((int)meta.metas.size()));
-        for (auto& m : meta.metas) addMsg(out, 0, m.first, m.second);
-
-        std::vector<MidiEvent> chAuto;
-        collectChannelSetupAndAutomation(in, trackIndex, channels, chAuto);
-        int lastTick = 0;
-        log.line("   [voice" + std::to_string(vnum) + "] inject automation: " + std::to_string((int)chAuto.size()));
-        for (auto& ev : chAuto) {
-            addMsg(out, 0, ev.tick, bytesFromEvent(ev));
-            if (ev.tick > lastTick) lastTick = ev.tick;
-        }
-
-        int lastNoteTick = writeNotesAndReturnLastTick(out, voice);
-        log.line("   [voice" + std::to_string(vnum) + "] lastNoteTick = " + std::to_string(lastNoteTick));
-        if (lastNoteTick > lastTick) lastTick = lastNoteTick;
-
-        addEndOfTrack(out, lastTick);
-        log.line("   [voice" + std::to_string(vnum) + "] EOT at ~" + std::to_string(lastTick+1));
+        buildStemFile(out, in, trackIndex, meta, channels, voice, log, "voice" + std::to_string(vnum));
 
         std::string fname = baseName + "-track" + std::to_string(trackIndex) + "-" +
                             instrumentNameSafe + "-voice" + std::to_string(vnum) + ".mid";
@@ -605,11 +872,841 @@ static void splitTrackVoices(const MidiFile& in,
     }
 }
 
+#endif // MIDIBREAKOUT_FUZZ
+
+// ------------------------ Raw SMF Streaming ------------------------
+
+// One event decoded straight from MTrk bytes, without going through MidiFile.
+// Bytes are kept in file layout with the status always explicit (running
+// status expanded): meta = FF type <vlq len> data, sysex = F0/F7 <vlq len> data.
+struct RawEvent {
+    long tick = 0;
+    std::vector<unsigned char> bytes;
+};
+
+struct SmfHeader {
+    int format   = 0;
+    int tracks   = 0;
+    int division = 0;
+};
+
+static void appendVlq(std::vector<unsigned char>& out, uint32_t v) {
+    unsigned char buf[5]; int n = 0;
+    buf[n++] = (unsigned char)(v & 0x7F);
+    while (v >>= 7) buf[n++] = (unsigned char)(0x80 | (v & 0x7F));
+    while (n) out.push_back(buf[--n]);
+}
+
+static bool readBE(std::streambuf* sb, int bytes, uint32_t& v) {
+    v = 0;
+    for (int i = 0; i < bytes; ++i) {
+        int c = sb->sbumpc();
+        if (c == std::char_traits<char>::eof()) return false;
+        v = (v << 8) | (uint32_t)c;
+    }
+    return true;
+}
+
+static bool readChunkHeader(std::streambuf* sb, std::string& id, uint32_t& len) {
+    char tag[4];
+    if (sb->sgetn(tag, 4) != 4) return false;
+    id.assign(tag, 4);
+    return readBE(sb, 4, len);
+}
+
+static bool skipBytes(std::streambuf* sb, uint32_t n) {
+    while (n > 0) {
+        if (sb->sbumpc() == std::char_traits<char>::eof()) return false;
+        --n;
+    }
+    return true;
+}
+
+// Reads the MThd chunk (and skips any extra header bytes).
+static bool readSmfHeader(std::streambuf* sb, SmfHeader& h) {
+    std::string id; uint32_t len = 0;
+    if (!readChunkHeader(sb, id, len) || id != "MThd" || len < 6) return false;
+    uint32_t fmt, ntr, div;
+    if (!readBE(sb, 2, fmt) || !readBE(sb, 2, ntr) || !readBE(sb, 2, div)) return false;
+    h.format = (int)fmt; h.tracks = (int)ntr; h.division = (int)div;
+    return skipBytes(sb, len - 6);
+}
+
+// Streams the events of one MTrk chunk and never reads past its length. A
+// malformed or truncated chunk just ends the stream with `truncated` set.
+struct MTrkReader {
+    std::streambuf* sb = nullptr;
+    uint32_t remaining = 0;
+    long tick = 0;
+    int running = 0;
+    bool truncated = false;
+    bool ended = false;     // End-Of-Track seen
+
+    void start(std::streambuf* s, uint32_t chunkLen) {
+        sb = s; remaining = chunkLen; tick = 0; running = 0; truncated = false; ended = false;
+    }
+
+    bool next(RawEvent& ev) {
+        if (ended || truncated || remaining == 0) return false;
+        if (!decode(ev)) return false;
+        tick = ev.tick; // only complete events advance the track's last tick
+        return true;
+    }
+
+    // Consumes whatever is left of the chunk so the next chunk can be read.
+    bool finish() {
+        bool ok = skipBytes(sb, remaining);
+        remaining = 0;
+        return ok;
+    }
+
+private:
+    bool decode(RawEvent& ev) {
+        uint32_t delta;
+        int b;
+        if (!vlq(delta) || !byte(b)) return fail();
+        ev.tick = tick + (long)delta;
+        ev.bytes.clear();
+
+        if (b == 0xFF) {
+            int type; uint32_t len;
+            if (!byte(type) || !vlq(len)) return fail();
+            ev.bytes.push_back(0xFF);
+            ev.bytes.push_back((unsigned char)type);
+            appendVlq(ev.bytes, len);
+            if (!data(ev.bytes, len)) return fail();
+            if (type == 0x2F) ended = true;
+            return true;
+        }
+        if (b == 0xF0 || b == 0xF7) {
+            uint32_t len;
+            if (!vlq(len)) return fail();
+            ev.bytes.push_back((unsigned char)b);
+            appendVlq(ev.bytes, len);
+            if (!data(ev.bytes, len)) return fail();
+            running = 0;
+            return true;
+        }
+
+        int first = -1;
+        if (b & 0x80) {
+            if (b >= 0xF0) return fail(); // system common/realtime is not valid in a file
+            running = b;
+        } else {
+            if (!running) return fail();
+            first = b;
+        }
+        ev.bytes.push_back((unsigned char)running);
+        int st = running & 0xF0;
+        int count = (st == 0xC0 || st == 0xD0) ? 1 : 2;
+        for (int i = 0; i < count; ++i) {
+            int d = first;
+            if (i > 0 || d < 0) { if (!byte(d)) return fail(); }
+            if (d & 0x80) return fail(); // a status byte where data belongs
+            ev.bytes.push_back((unsigned char)d);
+        }
+        return true;
+    }
+
+    bool fail() { truncated = true; return false; }
+
+    bool byte(int& b) {
+        if (remaining == 0) return false;
+        b = sb->sbumpc();
+        if (b == std::char_traits<char>::eof()) { remaining = 0; return false; }
+        --remaining;
+        return true;
+    }
+    bool vlq(uint32_t& v) {
+        v = 0;
+        for (int i = 0; i < 4; ++i) {
+            int b;
+            if (!byte(b)) return false;
+            v = (v << 7) | (uint32_t)(b & 0x7F);
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+    bool data(std::vector<unsigned char>& out, uint32_t len) {
+        if (len > remaining) return false;
+        for (uint32_t i = 0; i < len; ++i) {
+            int b;
+            if (!byte(b)) return false;
+            out.push_back((unsigned char)b);
+        }
+        return true;
+    }
+};
+
+// Writes one MTrk chunk to a seekable stream; the length is patched on close.
+// Identical non-note events landing on the same tick are emitted once, which
+// is what collapses the tempo map and channel setup every stem carries.
+struct MTrkWriter {
+    std::ostream* os = nullptr;
+    std::streampos lenPos;
+    uint32_t length = 0;
+    long lastTick = 0;
+    std::set<std::vector<unsigned char>> atTick; // non-note events already written at lastTick
+    std::vector<unsigned char> buf;
+
+    void begin(std::ostream& o) {
+        os = &o; length = 0; lastTick = 0; atTick.clear();
+        os->write("MTrk", 4);
+        lenPos = os->tellp();
+        os->write("\0\0\0\0", 4);
+    }
+
+    void add(long tick, const std::vector<unsigned char>& bytes) {
+        if (tick < lastTick) tick = lastTick;
+        if (tick != lastTick) atTick.clear();
+        int st = bytes.empty() ? 0 : (bytes[0] & 0xF0);
+        if (st != 0x80 && st != 0x90 && !atTick.insert(bytes).second) return;
+        buf.clear();
+        appendVlq(buf, (uint32_t)(tick - lastTick));
+        buf.insert(buf.end(), bytes.begin(), bytes.end());
+        os->write((const char*)buf.data(), (std::streamsize)buf.size());
+        length += (uint32_t)buf.size();
+        lastTick = tick;
+    }
+
+    void end(long tick) {
+        std::vector<unsigned char> eot = { 0xFF, 0x2F, 0x00 };
+        add(std::max(tick, lastTick), eot);
+        std::streampos endPos = os->tellp();
+        os->seekp(lenPos);
+        unsigned char be[4] = { (unsigned char)(length >> 24), (unsigned char)(length >> 16),
+                                (unsigned char)(length >> 8),  (unsigned char)length };
+        os->write((const char*)be, 4);
+        os->seekp(endPos);
+    }
+};
+
+inline bool isRawGlobalMeta(const std::vector<unsigned char>& b) {
+    return b.size() >= 2 && b[0] == 0xFF && (b[1] == 0x51 || b[1] == 0x58 || b[1] == 0x59);
+}
+
+inline bool isRawEndOfTrack(const std::vector<unsigned char>& b) {
+    return b.size() >= 2 && b[0] == 0xFF && b[1] == 0x2F;
+}
+
+typedef std::set<std::pair<long, std::vector<unsigned char>>> GlobalMetaSet; // tick, bytes
+
+// Same-tick order for the merge, as sortTracks() leaves a split stem: other
+// events first, then note-offs, then note-ons, so a pitch handed from one
+// voice to another is released before it is struck again.
+inline int rawEventRank(const std::vector<unsigned char>& b) {
+    int st = b.empty() ? 0 : (b[0] & 0xF0);
+    if (st == 0x80 || (st == 0x90 && b.size() >= 3 && b[2] == 0)) return 1;
+    if (st == 0x90) return 2;
+    return 0;
+}
+
+// One track being merged, positioned on its next event.
+struct MergeCursor {
+    MTrkReader reader;
+    RawEvent ev;
+    bool has = false;
+
+    void start(std::streambuf* sb, uint32_t chunkLen) { reader.start(sb, chunkLen); has = reader.next(ev); }
+    void advance() { has = reader.next(ev); }
+};
+
+// Heap-based k-way merge of already tick-sorted tracks into one track of
+// `w`. Only one pending event per track is held in memory; ties are broken
+// by rawEventRank(), then by track so voice order is stable. Tempo/signature
+// metas are diverted into `globals` for the conductor track. Returns the
+// last tick seen.
+static long mergeTracks(const std::vector<MergeCursor*>& tracks, MTrkWriter& w, GlobalMetaSet& globals) {
+    typedef std::tuple<long,int,int> Key; // tick, event rank, track index
+    std::priority_queue<Key, std::vector<Key>, std::greater<Key>> heap;
+    for (int ci = 0; ci < (int)tracks.size(); ++ci)
+        if (tracks[ci]->has) heap.push(Key(tracks[ci]->ev.tick, rawEventRank(tracks[ci]->ev.bytes), ci));
+
+    long lastTick = 0;
+    while (!heap.empty()) {
+        int ci = std::get<2>(heap.top());
+        heap.pop();
+        MergeCursor& c = *tracks[ci];
+        if (isRawGlobalMeta(c.ev.bytes)) globals.insert({c.ev.tick, c.ev.bytes});
+        else if (!isRawEndOfTrack(c.ev.bytes)) w.add(c.ev.tick, c.ev.bytes);
+        if (c.ev.tick > lastTick) lastTick = c.ev.tick;
+        c.advance();
+        if (c.has) heap.push(Key(c.ev.tick, rawEventRank(c.ev.bytes), ci));
+    }
+    return lastTick;
+}
+
+// ------------------------ Probe (track table without a full parse) ------------------------
+
+// scanTrackInfo() plus the extras a job planner wants, computed in one pass
+// over the raw MTrk bytes instead of MidiFile::read + absoluteTicks + sort.
+struct TrackProbe {
+    TrackInfo info;
+    int noteCount = 0;
+    int voiceEstimate = 0;  // peak number of simultaneously sounding notes
+    bool truncated = false;
+    bool endOfTrack = false;
+    int nameMetas = 0;      // track-name metas seen (the first one is reported)
+};
+
+static TrackProbe probeTrack(MTrkReader& rd, int trackIndex) {
+    TrackProbe tp;
+    tp.info.trackIndex = trackIndex;
+
+    int lastProgByCh[16];
+    int noteCountByCh[16] = {0};
+    std::fill(lastProgByCh, lastProgByCh + 16, -1);
+    bool haveName = false;
+
+    // Note pairing mirrors extractTrackNotes() on a sorted track: within one
+    // tick note-offs are applied before note-ons, and offs close the latest on.
+    struct Pending { bool off; int key; };
+    std::vector<Pending> pending;
+    long pendingTick = 0;
+    std::vector<std::vector<long>> ons(16 * 128);
+    std::vector<std::pair<long,int>> edges;   // (tick, +1 start / -1 end)
+
+    auto flush = [&]() {
+        for (const auto& p : pending) {
+            if (!p.off) continue;
+            auto& st = ons[p.key];
+            if (st.empty()) continue;
+            long start = st.back(); st.pop_back();
+            edges.push_back({start, 1});
+            edges.push_back({std::max(pendingTick, start + 1), -1});
+        }
+        for (const auto& p : pending) if (!p.off) ons[p.key].push_back(pendingTick);
+        pending.clear();
+    };
+
+    RawEvent ev;
+    while (rd.next(ev)) {
+        tp.info.eventCount++;
+        const auto& b = ev.bytes;
+        if (b[0] == 0xFF) {
+            if (b[1] == 0x03) tp.nameMetas++;
+            if (!haveName && b[1] == 0x03) {
+                size_t k = 2;
+                while (k < b.size() && (b[k] & 0x80)) ++k; // skip the length VLQ
+                tp.info.trackName.assign(b.begin() + std::min(k + 1, b.size()), b.end());
+                haveName = true;
+            }
+            continue;
+        }
+        if (b[0] >= 0xF0) continue;
+
+        int st = b[0] & 0xF0, ch = b[0] & 0x0F;
+        if (ch == 9) tp.info.hasChannel10 = true;
+        if (st == 0xC0) { lastProgByCh[ch] = b[1]; continue; }
+        bool on  = (st == 0x90 && b[2] > 0);
+        bool off = (st == 0x80) || (st == 0x90 && b[2] == 0);
+        if (!on && !off) continue;
+        if (on) noteCountByCh[ch]++;
+        if (ev.tick != pendingTick) { flush(); pendingTick = ev.tick; }
+        pending.push_back({off, (ch << 7) | b[1]});
+    }
+    flush();
+    // Like extractTrackNotes(), notes still open at the end close on the last tick.
+    for (const auto& st : ons)
+        for (long start : st) { edges.push_back({start, 1}); edges.push_back({std::max(rd.tick, start + 1), -1}); }
+    tp.truncated = rd.truncated;
+    tp.endOfTrack = rd.ended;
+
+    int bestCh = -1, bestCount = -1;
+    for (int ch = 0; ch < 16; ++ch) {
+        if (noteCountByCh[ch] > 0 && noteCountByCh[ch] > bestCount) { bestCount = noteCountByCh[ch]; bestCh = ch; }
+    }
+    if (bestCh >= 0) tp.info.programGuess = lastProgByCh[bestCh];
+
+    // Ends sort before starts on the same tick: a lane is free once endTick <= t.
+    std::sort(edges.begin(), edges.end());
+    int active = 0;
+    for (const auto& e : edges) {
+        active += e.second;
+        if (active > tp.voiceEstimate) tp.voiceEstimate = active;
+    }
+    tp.noteCount = (int)edges.size() / 2;
+    return tp;
+}
+
+static bool probeStream(std::streambuf* sb, SmfHeader& hdr, std::vector<TrackProbe>& out) {
+    if (!readSmfHeader(sb, hdr)) return false;
+    std::string id; uint32_t len;
+    MTrkReader rd;
+    while ((int)out.size() < hdr.tracks && readChunkHeader(sb, id, len)) {
+        if (id != "MTrk") {
+            if (!skipBytes(sb, len)) break;
+            continue;
+        }
+        rd.start(sb, len);
+        out.push_back(probeTrack(rd, (int)out.size()));
+        if (!rd.finish()) break;
+    }
+    return true;
+}
+
+// Length of the well-formed UTF-8 sequence starting at s[i], or 0 if the
+// bytes there are not one (overlong, surrogate, out of range or cut short).
+static size_t utf8SequenceLength(const std::string& s, size_t i) {
+    unsigned char c = (unsigned char)s[i];
+    size_t n; uint32_t cp, minCp;
+    if      (c >= 0xC2 && c <= 0xDF) { n = 2; cp = c & 0x1F; minCp = 0x80; }
+    else if (c >= 0xE0 && c <= 0xEF) { n = 3; cp = c & 0x0F; minCp = 0x800; }
+    else if (c >= 0xF0 && c <= 0xF4) { n = 4; cp = c & 0x07; minCp = 0x10000; }
+    else return 0;
+    if (i + n > s.size()) return 0;
+    for (size_t k = 1; k < n; ++k) {
+        unsigned char d = (unsigned char)s[i + k];
+        if ((d & 0xC0) != 0x80) return 0;
+        cp = (cp << 6) | (d & 0x3F);
+    }
+    if (cp < minCp || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return 0;
+    return n;
+}
+
+// JSON string literal: valid UTF-8 passes through, invalid bytes become U+FFFD.
+static std::string jsonString(const std::string& s) {
+    std::string o = "\"";
+    char buf[8];
+    for (size_t i = 0; i < s.size(); ) {
+        unsigned char c = (unsigned char)s[i];
+        if (c < 0x80) {
+            if (c == '"' || c == '\\') { o.push_back('\\'); o.push_back((char)c); }
+            else if (c < 0x20) { std::snprintf(buf, sizeof(buf), "\\u%04x", c); o += buf; }
+            else o.push_back((char)c);
+            ++i;
+            continue;
+        }
+        size_t n = utf8SequenceLength(s, i);
+        if (n) { o.append(s, i, n); i += n; }
+        else   { o += "\\ufffd"; ++i; }
+    }
+    return o + "\"";
+}
+
+#ifndef MIDIBREAKOUT_FUZZ // CLI only
+static bool probeFile(const fs::path& p, SmfHeader& hdr, std::vector<TrackProbe>& out) {
+    std::ifstream f(p, std::ios::in | std::ios::binary);
+    if (!f) return false;
+    return probeStream(f.rdbuf(), hdr, out);
+}
+
+static int printProbeJson(const fs::path& p) {
+    SmfHeader hdr;
+    std::vector<TrackProbe> tracks;
+    if (!probeFile(p, hdr, tracks)) {
+        std::cerr << "Failed to read MIDI.\n";
+        return 1;
+    }
+    std::ostringstream js;
+    js << "{\n  \"file\": " << jsonString(p.string())
+       << ",\n  \"format\": " << hdr.format
+       << ",\n  \"division\": " << hdr.division
+       << ",\n  \"tracks\": [";
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        const TrackProbe& tp = tracks[i];
+        const TrackInfo& ti = tp.info;
+        std::string inst = instrumentLabel(ti);
+        js << (i ? ",\n" : "\n")
+           << "    {\"index\": " << ti.trackIndex
+           << ", \"events\": " << ti.eventCount
+           << ", \"channel10\": " << (ti.hasChannel10 ? "true" : "false")
+           << ", \"program\": " << ti.programGuess
+           << ", \"instrument\": " << jsonString(inst)
+           << ", \"name\": " << jsonString(ti.trackName)
+           << ", \"notes\": " << tp.noteCount
+           << ", \"voices\": " << tp.voiceEstimate
+           << ", \"truncated\": " << (tp.truncated ? "true" : "false") << "}";
+    }
+    js << (tracks.empty() ? "]\n}\n" : "\n  ]\n}\n");
+    std::cout << js.str();
+    return 0;
+}
+
+// ------------------------ Recombine (split stems -> one SMF) ------------------------
+
+// A file written by this tool: <base>-trackN-<inst>-voiceM.mid, or the drum
+// stems <base>-trackN-drums.mid / <base>-trackN-cymbals.mid.
+struct StemFile {
+    fs::path path;
+    std::string base;
+    int track = -1;
+    std::string label;
+    int voice = 0;          // 0 for drum stems
+};
+
+static bool parseStemName(const fs::path& p, StemFile& out) {
+    static const std::regex voiceRe("^(.+)-track([0-9]+)-(.+)-voice([0-9]+)$");
+    static const std::regex drumRe ("^(.+)-track([0-9]+)-(drums|cymbals)$");
+    if (p.extension() != ".mid") return false;
+    std::string stem = p.stem().string();
+    std::smatch m;
+    try {
+        if (std::regex_match(stem, m, voiceRe)) {
+            out.voice = std::stoi(m[4].str());
+        } else if (std::regex_match(stem, m, drumRe)) {
+            out.voice = 0;
+        } else {
+            return false;
+        }
+        out.track = std::stoi(m[2].str());
+    } catch(...) {
+        return false; // numbers too large to be ours
+    }
+    out.path  = p;
+    out.base  = m[1].str();
+    out.label = m[3].str();
+    return true;
+}
+
+// One MTrk of a stem file. DAWs re-export edited stems as format 1
+// (conductor + notes), so every track gets its own cursor.
+struct StemCursor {
+    std::ifstream file;
+    MergeCursor track;
+
+    // Opens the `trackNo`-th MTrk chunk of `p`; false when there is none.
+    bool open(const fs::path& p, int trackNo) {
+        file.open(p, std::ios::in | std::ios::binary);
+        if (!file) return false;
+        std::streambuf* sb = file.rdbuf();
+        SmfHeader hdr;
+        if (!readSmfHeader(sb, hdr)) return false;
+        std::string id; uint32_t len;
+        while (readChunkHeader(sb, id, len)) {
+            if (id == "MTrk" && trackNo-- == 0) {
+                track.start(sb, len);
+                return true;
+            }
+            if (!skipBytes(sb, len)) break;
+        }
+        return false;
+    }
+};
+
+// Merges every track of the given stems into one track of `w`.
+static long mergeStems(const std::vector<const StemFile*>& stems, MTrkWriter& w,
+                       GlobalMetaSet& globals, Logger& log) {
+    std::vector<std::unique_ptr<StemCursor>> cur;
+    std::vector<MergeCursor*> tracks;
+    std::vector<const StemFile*> owner;
+    for (const StemFile* sf : stems) {
+        int opened = 0;
+        for (;;) {
+            std::unique_ptr<StemCursor> c(new StemCursor());
+            if (!c->open(sf->path, opened)) break;
+            opened++;
+            tracks.push_back(&c->track);
+            cur.push_back(std::move(c));
+            owner.push_back(sf);
+        }
+        if (opened == 0) log.line("   Cannot read " + sf->path.filename().string() + " (skip)");
+        else if (opened > 1) log.line("   " + sf->path.filename().string() + ": merging " + std::to_string(opened) + " tracks");
+    }
+
+    long lastTick = mergeTracks(tracks, w, globals);
+    for (size_t ci = 0; ci < tracks.size(); ++ci)
+        if (tracks[ci]->reader.truncated)
+            log.line("   Warning: " + owner[ci]->path.filename().string() + " is truncated");
+    return lastTick;
+}
+
+static bool writeRecombined(const std::string& base, std::vector<const StemFile*> stems,
+                            const fs::path& outPath, Logger& log) {
+    // Stems must agree on the time division to share one file.
+    int division = -1;
+    std::vector<const StemFile*> usable;
+    for (const StemFile* sf : stems) {
+        std::ifstream f(sf->path, std::ios::in | std::ios::binary);
+        SmfHeader hdr;
+        if (!f || !readSmfHeader(f.rdbuf(), hdr)) {
+            log.line("   Not a MIDI file: " + sf->path.filename().string() + " (skip)");
+            continue;
+        }
+        if (division < 0) division = hdr.division;
+        if (hdr.division != division) {
+            log.line("   Division mismatch in " + sf->path.filename().string() + " (skip)");
+            continue;
+        }
+        usable.push_back(sf);
+    }
+    if (usable.empty()) return false;
+
+    std::map<int, std::vector<const StemFile*>> byTrack; // original track -> its stems
+    for (const StemFile* sf : usable) byTrack[sf->track].push_back(sf);
+
+    auto nameMeta = [](const std::string& name) {
+        std::vector<unsigned char> b = { 0xFF, 0x03 };
+        appendVlq(b, (uint32_t)name.size());
+        b.insert(b.end(), name.begin(), name.end());
+        return b;
+    };
+
+    // Each stem is decoded once: the instrument tracks are spooled to a part
+    // file while the tempo map is collected, then the conductor is written
+    // first and the spooled tracks are copied after it as raw bytes.
+    fs::path partPath = outPath;
+    partPath += ".part";
+    GlobalMetaSet globals;
+    long endTick = 0;
+    {
+        std::ofstream part(partPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!part) {
+            log.line("   ERROR: cannot open " + partPath.string());
+            return false;
+        }
+        MTrkWriter w;
+        for (auto& kv : byTrack) {
+            std::vector<const StemFile*>& group = kv.second;
+            std::sort(group.begin(), group.end(), [](const StemFile* a, const StemFile* b){
+                if (a->label != b->label) return a->label < b->label;
+                return a->voice < b->voice;
+            });
+            w.begin(part);
+            w.add(0, nameMeta(group.front()->label));
+            long last = mergeStems(group, w, globals, log);
+            w.end(last);
+            endTick = std::max(endTick, last);
+            log.line("  [track" + std::to_string(kv.first) + "] merged " + std::to_string(group.size()) + " stems");
+        }
+        part.flush();
+        if (!part) {
+            log.line("   ERROR: write failed: " + partPath.string());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    bool ok = false;
+    {
+        std::ofstream out(outPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        std::ifstream part(partPath, std::ios::in | std::ios::binary);
+        if (out && part) {
+            int ntracks = 1 + (int)byTrack.size();
+            unsigned char hdr[14] = { 'M','T','h','d', 0,0,0,6, 0,1,
+                                      (unsigned char)(ntracks >> 8), (unsigned char)ntracks,
+                                      (unsigned char)(division >> 8), (unsigned char)division };
+            out.write((const char*)hdr, sizeof(hdr));
+
+            // Track 0: tempo map and signatures, each emitted once.
+            MTrkWriter w;
+            w.begin(out);
+            w.add(0, nameMeta(base));
+            for (const auto& m : globals) w.add(m.first, m.second);
+            w.end(endTick);
+            log.line("  [conductor] global metas: " + std::to_string(globals.size()));
+
+            if (part.peek() != std::char_traits<char>::eof()) out << part.rdbuf();
+            out.flush();
+            ok = (bool)out;
+        }
+    }
+    fs::remove(partPath, ec);
+    if (!ok) {
+        log.line("   ERROR: write failed: " + outPath.string());
+        return false;
+    }
+    log.line("  Wrote: " + outPath.string());
+    return true;
+}
+
+// Recombines every set of stems found in `dir`, one output file per base name.
+static int recombineFolder(const fs::path& dir, Logger& log) {
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec)) {
+        log.line("Not a folder: " + dir.string());
+        return 1;
+    }
+    std::vector<StemFile> stems;
+    for (const auto& de : fs::directory_iterator(dir, ec)) {
+        StemFile sf;
+        if (de.is_regular_file(ec) && parseStemName(de.path(), sf)) stems.push_back(sf);
+    }
+    log.line("Stems found: " + std::to_string(stems.size()));
+    if (stems.empty()) return 1;
+
+    std::map<std::string, std::vector<const StemFile*>> byBase;
+    for (const auto& sf : stems) byBase[sf.base].push_back(&sf);
+
+    int failures = 0;
+    for (auto& kv : byBase) {
+        log.line("\nRecombining " + kv.first + " (" + std::to_string(kv.second.size()) + " stems)...");
+        fs::path outPath = dir / (kv.first + " - Recombined.mid");
+        if (!writeRecombined(kv.first, kv.second, outPath, log)) failures++;
+    }
+    return failures ? 1 : 0;
+}
+
+// ------------------------ Voice Benchmark ------------------------
+
+// Deterministic synthetic track: block chords mixed with sustained arpeggios,
+// which is where greedy lane assignment jumps registers the most.
+static std::vector<NoteSpan> makeBenchNotes(int count) {
+    std::vector<NoteSpan> notes;
+    notes.reserve(count);
+    uint32_t seed = 0x12345678u;
+    auto rnd = [&](int n) { seed = seed * 1664525u + 1013904223u; return (int)((seed >> 8) % (uint32_t)n); };
+    int tick = 0;
+    while ((int)notes.size() < count) {
+        int root = 36 + rnd(36);
+        if (rnd(2) == 0) {
+            int width = 2 + rnd(4);
+            for (int k = 0; k < width && (int)notes.size() < count; ++k)
+                notes.push_back({tick, tick + 240, std::min(127, root + k * (3 + rnd(3))), 90, 0});
+            tick += 240;
+        } else {
+            int len = 4 + rnd(5);
+            for (int k = 0; k < len && (int)notes.size() < count; ++k) {
+                notes.push_back({tick, tick + 360, std::min(127, root + rnd(24)), 80, 0});
+                tick += 60;
+            }
+        }
+    }
+    std::sort(notes.begin(), notes.end(),
+              [](const NoteSpan& a, const NoteSpan& b){
+                  if (a.startTick != b.startTick) return a.startTick < b.startTick;
+                  return a.pitch > b.pitch;
+              });
+    return notes;
+}
+
+// Dense clusters hundreds of notes wide (black-MIDI style), the worst case for
+// per-chord matching.
+static std::vector<NoteSpan> makeWideChordNotes(int count) {
+    std::vector<NoteSpan> notes;
+    notes.reserve(count);
+    uint32_t seed = 0x9e3779b9u;
+    auto rnd = [&](int n) { seed = seed * 1664525u + 1013904223u; return (int)((seed >> 8) % (uint32_t)n); };
+    int tick = 0;
+    while ((int)notes.size() < count) {
+        int width = 200 + rnd(1800);
+        int len = 60 + rnd(240);
+        for (int k = 0; k < width && (int)notes.size() < count; ++k)
+            notes.push_back({tick, tick + len, 21 + rnd(88), 100, k & 0x0F});
+        tick += 60 + rnd(120);
+    }
+    std::sort(notes.begin(), notes.end(),
+              [](const NoteSpan& a, const NoteSpan& b){
+                  if (a.startTick != b.startTick) return a.startTick < b.startTick;
+                  return a.pitch > b.pitch;
+              });
+    return notes;
+}
+
+static long long totalPitchMovement(const std::vector<std::vector<NoteSpan>>& voices) {
+    long long sum = 0;
+    for (const auto& v : voices)
+        for (size_t i = 1; i < v.size(); ++i) sum += std::abs(v[i].pitch - v[i-1].pitch);
+    return sum;
+}
+
+static void runVoiceBenchmark(int noteCount, int maxVoices) {
+    auto runSet = [&](const char* title, const std::vector<NoteSpan>& notes) {
+        std::cout << title << ": " << notes.size() << " notes\n";
+
+        auto run = [&](const char* label, const VoiceOptions& opt) {
+            VoiceStats st;
+            auto t0 = std::chrono::steady_clock::now();
+            auto voices = assignVoices(notes, opt, &st);
+            auto t1 = std::chrono::steady_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            std::cout << "  " << label << ": " << ms << " ms | voices=" << voices.size()
+                      << " | pitch movement=" << totalPitchMovement(voices);
+            if (st.stackedTones) std::cout << " | stacked chord tones=" << st.stackedTones;
+            std::cout << "\n";
+        };
+
+        VoiceOptions greedy;
+        run("greedy       ", greedy);
+        VoiceOptions leading;
+        leading.voiceLeading = true;
+        run("voice-leading", leading);
+        if (maxVoices > 0) {
+            leading.maxVoices = maxVoices;
+            run(("voice-leading (max " + std::to_string(maxVoices) + ")").c_str(), leading);
+        }
+    };
+
+    runSet("Voice assignment benchmark", makeBenchNotes(noteCount));
+    runSet("Wide-chord benchmark", makeWideChordNotes(noteCount));
+}
+
+// ------------------------ Command Line ------------------------
+
+// All switches are optional; without any the program runs interactively.
+struct CliOptions {
+    VoiceOptions voice;
+    bool benchVoices = false;
+    int  benchNotes  = 1000000;
+    std::string recombineDir;
+    std::string probePath;
+};
+
+static void printUsage() {
+    std::cout << "Usage: MIDIBreakout [--voice-leading] [--max-voices N]\n"
+                 "       MIDIBreakout --bench-voices [NOTES] [--max-voices N]\n"
+                 "       MIDIBreakout --recombine <folder-with-split-stems>\n"
+                 "       MIDIBreakout --probe <file.mid>   (track table as JSON)\n";
+}
+
+static bool parseArgs(int argc, char** argv, CliOptions& cli) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto intArg = [&](int& dst)->bool {
+            if (i + 1 >= argc) return false;
+            try { dst = std::stoi(argv[++i]); } catch(...) { return false; }
+            return dst >= 0;
+        };
+        if (a == "--voice-leading") {
+            cli.voice.voiceLeading = true;
+        } else if (a == "--max-voices") {
+            if (!intArg(cli.voice.maxVoices)) return false;
+            cli.voice.voiceLeading = true; // the cap is a voice-leading option
+        } else if (a == "--recombine") {
+            if (i + 1 >= argc) return false;
+            cli.recombineDir = argv[++i];
+        } else if (a == "--probe") {
+            if (i + 1 >= argc) return false;
+            cli.probePath = argv[++i];
+        } else if (a == "--bench-voices") {
+            cli.benchVoices = true;
+            if (i + 1 < argc && std::isdigit((unsigned char)argv[i+1][0]) && !intArg(cli.benchNotes)) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
 // ------------------------ Main ------------------------
 
-int main() {
+int main(int argc, char** argv) {
     std::ios::sync_with_stdio(false);
 
+    CliOptions cli;
+    if (!parseArgs(argc, argv, cli)) {
+        printUsage();
+        return 1;
+    }
+    if (cli.benchVoices) {
+        runVoiceBenchmark(cli.benchNotes, cli.voice.maxVoices);
+        return 0;
+    }
+    if (!cli.probePath.empty()) {
+        return printProbeJson(fs::path(cli.probePath));
+    }
+    if (!cli.recombineDir.empty()) {
+        fs::path dir(cli.recombineDir);
+        Logger log;
+        fs::path logPath = openLog(log, dir);
+        log.line("=== MIDI Stem Recombine ===");
+        log.line(std::string("Log: ") + logPath.string());
+        log.line("Folder: " + dir.string());
+        int rc = recombineFolder(dir, log);
+        log.line("\nDone.");
+        return rc;
+    }
+
     std::cout << "Enter full path to a MIDI file (.mid): ";
     std::string inPathStr;
     std::getline(std::cin, inPathStr);
@@ -627,12 +1724,7 @@ int main() {
 
     // Logging: try EXE dir, fall back to source dir
     Logger log;
-    fs::path logPath = exeDir() / "MIDI_Voice_Separation_Log.txt";
-    log.openAt(logPath);
-    if (!log.ok) {
-        logPath = srcDir / "MIDI_Voice_Separation_Log.txt";
-        log.openAt(logPath);
-    }
+    fs::path logPath = openLog(log, srcDir);
     log.line("=== MIDI Voice Separation ===");
     log.line(std::string("Log: ") + logPath.string());
 
@@ -653,13 +1745,13 @@ int main() {
     log.line("Input file: " + inPath.string());
     log.line("TicksPerQuarter: " + std::to_string(in.getTicksPerQuarterNote()));
     log.line("Tracks: " + std::to_string(in.getTrackCount()));
+    log.line(std::string("Voice mode: ") + (cli.voice.voiceLeading ? "voice-leading" : "greedy") +
+             (cli.voice.maxVoices > 0 ? " (max " + std::to_string(cli.voice.maxVoices) + ")" : ""));
 
     // Scan tracks
     auto infos = scanTrackInfo(in);
     for (auto& ti : infos) {
-        std::string inst = ti.hasChannel10
-            ? "Percussion (Ch10)"
-            : (ti.programGuess >= 0 ? std::string(GM_NAMES[ti.programGuess]) : "Unknown");
+        std::string inst = instrumentLabel(ti);
         log.line("Track " + std::to_string(ti.trackIndex) + " | events=" + std::to_string(ti.eventCount) +
                  (ti.trackName.empty() ? "" : " | Name: " + ti.trackName) +
                  " | " + inst);
@@ -708,8 +1800,8 @@ int main() {
             if (noteCheck.empty()) {
                 log.line(" Selected track has no notes. Nothing to write.");
             } else {
-                std::string inst = (ti.programGuess >= 0) ? filenameSafe(GM_NAMES[ti.programGuess]) : std::string("Instrument");
-                splitTrackVoices(in, tsel, meta, outDir, baseName, inst, log);
+                std::string inst = (ti.programGuess >= 0 && ti.programGuess < 128) ? filenameSafe(GM_NAMES[ti.programGuess]) : std::string("Instrument");
+                splitTrackVoices(in, tsel, meta, outDir, baseName, inst, cli.voice, log);
             }
         }
     } else {
@@ -723,8 +1815,8 @@ int main() {
                 auto noteCheck = extractTrackNotes(in, ti.trackIndex, nullptr);
                 log.line("  Pre-check notes: " + std::to_string(noteCheck.size()));
                 if (noteCheck.empty()) { log.line("  No notes (skip)."); continue; }
-                std::string inst = (ti.programGuess >= 0) ? filenameSafe(GM_NAMES[ti.programGuess]) : std::string("Instrument");
-                splitTrackVoices(in, ti.trackIndex, meta, outDir, baseName, inst, log);
+                std::string inst = (ti.programGuess >= 0 && ti.programGuess < 128) ? filenameSafe(GM_NAMES[ti.programGuess]) : std::string("Instrument");
+                splitTrackVoices(in, ti.trackIndex, meta, outDir, baseName, inst, cli.voice, log);
             }
         }
     }
@@ -740,3 +1832,298 @@ int main() {
 
     return 0;
 }
+#endif // MIDIBREAKOUT_FUZZ
+
+// ------------------------ Fuzz Harness ------------------------
+//
+// libFuzzer entry point for the read -> extract -> voice -> write path and the
+// raw-byte paths behind --probe and --recombine (AFL++ drives it through its
+// libFuzzer driver). Build instead of main():
+//   clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -DMIDIBREAKOUT_FUZZ
+//           main.cpp <midifile>/src/*.cpp -I<midifile>/include -o midibreakout_fuzz
+// Add -DMIDIBREAKOUT_FUZZ_DIFFERENTIAL to also compare the fast paths (raw
+// probe, voice-leading) against the reference ones (MidiFile scan, greedy).
+// Known gap: scanTrackInfo() assumes a one-byte name length, so names are
+// only compared when shorter than 128 bytes and the track has a single one.
+
+#ifdef MIDIBREAKOUT_FUZZ
+
+#define FUZZ_CHECK(cond) \
+    do { if (!(cond)) { std::fprintf(stderr, "invariant failed: %s (line %d)\n", #cond, __LINE__); std::abort(); } } while (0)
+
+// Every note lands in exactly one voice and no voice overlaps itself. With a
+// cap the voice count holds and only same-start chord tones may share a voice.
+static void checkVoices(const std::vector<NoteSpan>& notes,
+                        const std::vector<std::vector<NoteSpan>>& voices,
+                        int maxVoices = 0) {
+    size_t total = 0;
+    if (maxVoices > 0) FUZZ_CHECK((int)voices.size() <= maxVoices);
+    for (const auto& v : voices) {
+        total += v.size();
+        int groupEnd = 0;
+        for (size_t i = 0; i < v.size(); ++i) {
+            FUZZ_CHECK(v[i].endTick > v[i].startTick);
+            bool stacked = (i > 0 && v[i].startTick == v[i-1].startTick);
+            if (stacked) {
+                FUZZ_CHECK(maxVoices > 0);
+            } else {
+                if (i > 0) FUZZ_CHECK(v[i].startTick >= groupEnd);
+                groupEnd = 0;
+            }
+            groupEnd = std::max(groupEnd, v[i].endTick);
+        }
+    }
+    FUZZ_CHECK(total == notes.size());
+}
+
+// Builds and serializes a stem exactly as the split does, then re-reads the
+// bytes: the notes must all come back, still monophonic, ending with an EOT.
+static void checkWrittenStem(const MidiFile& in, int trackIndex, const MetaCopy& meta,
+                             const std::set<int>& channels, const std::vector<NoteSpan>& notes,
+                             Logger& log) {
+    MidiFile out;
+    buildStemFile(out, in, trackIndex, meta, channels, notes, log, "fuzz");
+    normalizeForWrite(out, log, "fuzz");
+    std::ostringstream os;
+    FUZZ_CHECK(out.write(os));
+
+    std::istringstream is(os.str());
+    SmfHeader hdr;
+    std::vector<TrackProbe> tracks;
+    FUZZ_CHECK(probeStream(is.rdbuf(), hdr, tracks));
+    FUZZ_CHECK(!tracks.empty());
+    int written = 0;
+    for (const auto& tp : tracks) {
+        FUZZ_CHECK(!tp.truncated);
+        FUZZ_CHECK(tp.endOfTrack);
+        FUZZ_CHECK(tp.voiceEstimate <= 1);
+        written += tp.noteCount;
+    }
+    FUZZ_CHECK(written == (int)notes.size());
+}
+
+// Splits one track into `stemCount` pseudo-stems the way a split leaves
+// them (notes paired, never zero-length, each stem sorted like sortTracks()),
+// handing successive notes of a pitch to different stems so releases and
+// re-strikes collide on the same tick, then merges them back through
+// mergeTracks(). Read in file order, every note-off must close a note-on
+// from an earlier tick and every note must come back.
+static void checkMerge(const std::vector<RawEvent>& events, long endTick, int stemCount) {
+    struct Open { long tick; std::vector<unsigned char> bytes; };
+    std::vector<std::vector<RawEvent>> stems(stemCount);
+    std::map<int, std::vector<Open>> open; // channel << 8 | pitch
+    std::map<int, int> struck;
+    int notes = 0;
+    auto emit = [&](const Open& on, long offTick, const std::vector<unsigned char>& off) {
+        int key = (on.bytes[0] & 0x0F) << 8 | on.bytes[1];
+        std::vector<RawEvent>& stem = stems[struck[key]++ % stemCount];
+        stem.push_back({on.tick, on.bytes});
+        stem.push_back({std::max(offTick, on.tick + 1), off});
+        notes++;
+    };
+    for (const RawEvent& ev : events) {
+        int st = ev.bytes[0] & 0xF0;
+        if (st == 0x80 || st == 0x90) {
+            int key = (ev.bytes[0] & 0x0F) << 8 | ev.bytes[1];
+            if (rawEventRank(ev.bytes) == 2) {
+                open[key].push_back({ev.tick, ev.bytes});
+            } else if (!open[key].empty()) {
+                emit(open[key].back(), ev.tick, ev.bytes);
+                open[key].pop_back();
+            }
+        } else if (!isRawEndOfTrack(ev.bytes)) {
+            for (auto& stem : stems) stem.push_back(ev); // every stem carries the setup
+        }
+    }
+    for (auto& kv : open)
+        for (const Open& on : kv.second)
+            emit(on, endTick, { (unsigned char)(0x80 | (on.bytes[0] & 0x0F)), on.bytes[1], 0 });
+
+    std::vector<std::unique_ptr<std::stringstream>> files;
+    std::vector<MergeCursor> cursors(stemCount);
+    std::vector<MergeCursor*> tracks;
+    for (int s = 0; s < stemCount; ++s) {
+        std::stable_sort(stems[s].begin(), stems[s].end(), [](const RawEvent& a, const RawEvent& b) {
+            return a.tick != b.tick ? a.tick < b.tick : rawEventRank(a.bytes) < rawEventRank(b.bytes);
+        });
+        files.emplace_back(new std::stringstream(std::ios::in | std::ios::out | std::ios::binary));
+        MTrkWriter w;
+        w.begin(*files.back());
+        for (const RawEvent& ev : stems[s]) w.add(ev.tick, ev.bytes);
+        w.end(endTick);
+
+        std::string id; uint32_t len;
+        FUZZ_CHECK(readChunkHeader(files.back()->rdbuf(), id, len) && id == "MTrk");
+        cursors[s].start(files.back()->rdbuf(), len);
+        tracks.push_back(&cursors[s]);
+    }
+
+    std::stringstream merged(std::ios::in | std::ios::out | std::ios::binary);
+    MTrkWriter w;
+    GlobalMetaSet globals;
+    w.begin(merged);
+    w.end(mergeTracks(tracks, w, globals));
+    for (const MergeCursor& c : cursors) FUZZ_CHECK(!c.reader.truncated);
+
+    std::string id; uint32_t len;
+    FUZZ_CHECK(readChunkHeader(merged.rdbuf(), id, len) && id == "MTrk");
+    MTrkReader rd;
+    rd.start(merged.rdbuf(), len);
+    RawEvent ev;
+    std::map<int, std::vector<long>> sounding;
+    int ons = 0, offs = 0;
+    while (rd.next(ev)) {
+        int st = ev.bytes[0] & 0xF0;
+        if (st != 0x80 && st != 0x90) continue;
+        int key = (ev.bytes[0] & 0x0F) << 8 | ev.bytes[1];
+        if (rawEventRank(ev.bytes) == 2) {
+            sounding[key].push_back(ev.tick);
+            ons++;
+        } else {
+            FUZZ_CHECK(!sounding[key].empty());
+            FUZZ_CHECK(sounding[key].back() < ev.tick);
+            sounding[key].pop_back();
+            offs++;
+        }
+    }
+    FUZZ_CHECK(rd.finish());
+    FUZZ_CHECK(ons == notes);
+    FUZZ_CHECK(offs == notes);
+}
+
+// Probes the raw bytes, then copies every track through MTrkReader/MTrkWriter
+// (the recombine path) and probes the copy: whatever the input, the copy must
+// parse cleanly, end with an EOT and keep every note. Each track is also
+// split and re-merged by checkMerge(). Returns the first probe.
+static std::vector<TrackProbe> checkRawPaths(const std::string& bytes) {
+    std::vector<TrackProbe> probed;
+    SmfHeader hdr;
+    {
+        std::istringstream is(bytes);
+        if (!probeStream(is.rdbuf(), hdr, probed)) return probed;
+    }
+    for (const auto& tp : probed) {
+        FUZZ_CHECK(!instrumentLabel(tp.info).empty());
+        FUZZ_CHECK(jsonString(instrumentLabel(tp.info) + tp.info.trackName).size() >= 2);
+    }
+
+    std::istringstream is(bytes);
+    std::stringstream copy(std::ios::in | std::ios::out | std::ios::binary);
+    std::streambuf* sb = is.rdbuf();
+    FUZZ_CHECK(readSmfHeader(sb, hdr));
+    unsigned char head[14] = { 'M','T','h','d', 0,0,0,6,
+                               (unsigned char)(hdr.format >> 8), (unsigned char)hdr.format,
+                               (unsigned char)(probed.size() >> 8), (unsigned char)probed.size(),
+                               (unsigned char)(hdr.division >> 8), (unsigned char)hdr.division };
+    copy.write((const char*)head, sizeof(head));
+
+    std::string id; uint32_t len;
+    MTrkReader rd;
+    MTrkWriter w;
+    RawEvent ev;
+    std::vector<RawEvent> events;
+    size_t copied = 0;
+    while (copied < probed.size() && readChunkHeader(sb, id, len)) {
+        if (id != "MTrk") {
+            if (!skipBytes(sb, len)) break;
+            continue;
+        }
+        rd.start(sb, len);
+        w.begin(copy);
+        events.clear();
+        while (rd.next(ev)) {
+            if (!isRawEndOfTrack(ev.bytes)) w.add(ev.tick, ev.bytes);
+            events.push_back(ev);
+        }
+        w.end(rd.tick);
+        checkMerge(events, rd.tick, 2 + (int)(copied % 2));
+        copied++;
+        if (!rd.finish()) break;
+    }
+    FUZZ_CHECK(copied == probed.size());
+
+    SmfHeader hdr2;
+    std::vector<TrackProbe> again;
+    FUZZ_CHECK(probeStream(copy.rdbuf(), hdr2, again));
+    FUZZ_CHECK(again.size() == probed.size());
+    for (size_t t = 0; t < again.size(); ++t) {
+        FUZZ_CHECK(!again[t].truncated);
+        FUZZ_CHECK(again[t].endOfTrack);
+        FUZZ_CHECK(again[t].noteCount == probed[t].noteCount);
+        FUZZ_CHECK(again[t].voiceEstimate == probed[t].voiceEstimate);
+        FUZZ_CHECK(again[t].info.hasChannel10 == probed[t].info.hasChannel10);
+        FUZZ_CHECK(again[t].info.trackName == probed[t].info.trackName);
+    }
+    return probed;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string bytes((const char*)data, size);
+
+    // The raw parsers must survive any bytes, parseable by MidiFile or not.
+    std::vector<TrackProbe> probed = checkRawPaths(bytes);
+
+    std::istringstream is(bytes);
+    MidiFile in;
+    if (!in.read(is)) return 0;
+
+    in.absoluteTicks();
+    in.doTimeAnalysis();
+    in.linkNotePairs();
+    in.sortTracks();
+
+    Logger log;
+    log.quiet = true;
+    MetaCopy meta = collectGlobalMeta(in);
+    auto infos = scanTrackInfo(in);
+
+#ifdef MIDIBREAKOUT_FUZZ_DIFFERENTIAL
+    bool probeOk = (int)probed.size() == in.getTrackCount();
+    for (const auto& tp : probed) probeOk = probeOk && !tp.truncated;
+#endif
+
+    for (int t = 0; t < in.getTrackCount(); ++t) {
+        int noteOns = 0;
+        for (int i = 0; i < in[t].getEventCount(); ++i) {
+            int ch, p, v;
+            if (isNoteOn(in[t][i], ch, p, v)) noteOns++;
+        }
+        std::set<int> channels;
+        NoteStats stats;
+        auto notes = extractTrackNotes(in, t, &channels, &stats);
+        logNoteStats(stats, log);
+        FUZZ_CHECK((int)notes.size() == noteOns);
+
+        VoiceOptions greedy;
+        VoiceOptions leading;   leading.voiceLeading = true;
+        VoiceOptions capped;    capped.voiceLeading = true; capped.maxVoices = 2;
+        auto vGreedy  = extractVoicesFromTrack(in, t, greedy);
+        auto vLeading = assignVoices(notes, leading);
+        checkVoices(notes, vGreedy);
+        checkVoices(notes, vLeading);
+        checkVoices(notes, assignVoices(notes, capped), capped.maxVoices);
+
+        for (const auto& v : vGreedy) checkWrittenStem(in, t, meta, channels, v, log);
+
+#ifdef MIDIBREAKOUT_FUZZ_DIFFERENTIAL
+        // Uncapped voice-leading only reorders lanes, so it needs exactly as
+        // many voices as greedy (both equal the peak polyphony).
+        FUZZ_CHECK(vLeading.size() == vGreedy.size());
+        if (probeOk) {
+            const TrackProbe& tp = probed[t];
+            FUZZ_CHECK(tp.info.eventCount == infos[t].eventCount);
+            FUZZ_CHECK(tp.info.hasChannel10 == infos[t].hasChannel10);
+            FUZZ_CHECK(tp.info.programGuess == infos[t].programGuess);
+            if (tp.nameMetas == 1 && tp.info.trackName.size() < 128)
+                FUZZ_CHECK(tp.info.trackName == infos[t].trackName);
+            FUZZ_CHECK(tp.noteCount == (int)notes.size());
+            FUZZ_CHECK(tp.voiceEstimate == (int)vGreedy.size());
+        }
+#endif
+    }
+    (void)probed;
+    (void)infos;
+    return 0;
+}
+
+#endif // MIDIBREAKOUT_FUZZ